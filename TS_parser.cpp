@@ -1,16 +1,158 @@
 #include "tsCommon.h"
 #include "tsTransportStream.h"
+#include "tsFileFollower.h"
+#include "tsReplay.h"
 
 
+#include <chrono>
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
 
 //=============================================================================================================================================================================
 
-int main(int argc, char* argv[], char* envp[])
+static constexpr int32_t  AnalyzedPID = 136;
+static constexpr uint32_t CheckpointMagic = 0x50435354; // "TSCP"
+static constexpr uint32_t CheckpointVersion = 7;
+static constexpr int32_t  CheckpointInterval_ms = 1000; // minimal time between checkpoints
+
+static volatile sig_atomic_t StopRequested = 0;
+
+static void xHandleStopSignal(int) { StopRequested = 1; }
+
+//=============================================================================================================================================================================
+// Checkpoint - parser state needed to resume analysis of growing file
+//=============================================================================================================================================================================
+
+struct xParserState
+{
+    uint64_t ByteOffset = 0;  // offset of first not yet processed TS packet
+    int64_t  TS_PacketId = 0;
+    uint8_t  FirstPacket[xTS::TS_PacketLength] = {}; // identifies input file (valid once ByteOffset > 0)
+};
+
+/// @brief Write checkpoint to temporary file and atomically replace the old one
+static bool xSaveCheckpoint(const std::string& Path, const xParserState& State, const xPES_Assembler& Assembler, const xTS_ScramblingStatistics& ScramblingStatistics)
+{
+    const std::string TmpPath = Path + ".tmp";
+    FILE* File = fopen(TmpPath.c_str(), "wb");
+    if (!File) return false;
+
+    bool Ok = fwrite(&CheckpointMagic, sizeof(CheckpointMagic), 1, File) == 1 &&
+        fwrite(&CheckpointVersion, sizeof(CheckpointVersion), 1, File) == 1 &&
+        fwrite(&State.ByteOffset, sizeof(State.ByteOffset), 1, File) == 1 &&
+        fwrite(&State.TS_PacketId, sizeof(State.TS_PacketId), 1, File) == 1 &&
+        fwrite(State.FirstPacket, 1, sizeof(State.FirstPacket), File) == sizeof(State.FirstPacket) &&
+        Assembler.SaveState(File) &&
+        ScramblingStatistics.SaveState(File);
+    Ok = (fclose(File) == 0) && Ok;
+    if (!Ok) return false;
+
+    std::error_code Error;
+    std::filesystem::rename(TmpPath, Path, Error);
+    return !Error;
+}
+
+/// @brief Read checkpoint written by xSaveCheckpoint (Assembler must be initialized)
+static bool xLoadCheckpoint(const std::string& Path, xParserState& State, xPES_Assembler& Assembler, xTS_ScramblingStatistics& ScramblingStatistics)
+{
+    FILE* File = fopen(Path.c_str(), "rb");
+    if (!File) return false;
+
+    uint32_t Magic = 0;
+    uint32_t Version = 0;
+    bool Ok = fread(&Magic, sizeof(Magic), 1, File) == 1 && Magic == CheckpointMagic &&
+        fread(&Version, sizeof(Version), 1, File) == 1 && Version == CheckpointVersion &&
+        fread(&State.ByteOffset, sizeof(State.ByteOffset), 1, File) == 1 &&
+        fread(&State.TS_PacketId, sizeof(State.TS_PacketId), 1, File) == 1 &&
+        fread(State.FirstPacket, 1, sizeof(State.FirstPacket), File) == sizeof(State.FirstPacket) &&
+        Assembler.LoadState(File) &&
+        ScramblingStatistics.LoadState(File);
+    fclose(File);
+    return Ok;
+}
+
+/**
+@brief Check that checkpoint belongs to input file and the file was not truncated or rotated
+@return nullptr if input matches, otherwise reason of mismatch
+*/
+static const char* xCheckInput(const char* InputPath, FILE* Input, const xParserState& State)
+{
+    std::error_code Error;
+    const uintmax_t InputSize = std::filesystem::file_size(InputPath, Error);
+    if (Error) return "cannot get input file size";
+    if (InputSize < State.ByteOffset) return "input file is shorter than checkpointed offset (truncated or rotated)";
+    if (State.ByteOffset == 0) return nullptr;
+
+    uint8_t FirstPacket[xTS::TS_PacketLength];
+    if (xFileSeek(Input, 0) != 0 || fread(FirstPacket, 1, sizeof(FirstPacket), Input) != sizeof(FirstPacket) ||
+        memcmp(FirstPacket, State.FirstPacket, sizeof(FirstPacket)) != 0) {
+        return "input file differs from the one checkpoint was made for";
+    }
+    return nullptr;
+}
+
+//=============================================================================================================================================================================
+
+static void xPrintUsage(const char* ProgramName)
 {
+    fprintf(stderr, "usage: %s <file.ts> [--follow] [--checkpoint <file>] [--recovery] [--emit-partial]\n", ProgramName);
+    fprintf(stderr, "       %s <file.ts> --replay <host:port> [--rate <multiplier>]\n", ProgramName);
+    fprintf(stderr, "  --follow             keep reading as the file grows (stop with Ctrl+C)\n");
+    fprintf(stderr, "  --checkpoint <file>  save parser state to <file> and resume from it on start\n");
+    fprintf(stderr, "  --recovery           drop duplicate packets and honour discontinuity flag instead of dropping PES\n");
+    fprintf(stderr, "  --emit-partial       keep PES with lost packets and report gaps (implies --recovery)\n");
+    fprintf(stderr, "  --replay <host:port> send the capture over UDP paced by its PCRs\n");
+    fprintf(stderr, "  --rate <multiplier>  replay speed, 1.0 = real time (default)\n");
+}
+
+int main(int argc, char* argv[])
+{
+    const char* InputPath = nullptr;
+    std::string CheckpointPath;
+    const char* ReplayDestination = nullptr;
+    double ReplayRate = 1.0;
+    bool Follow = false;
+    bool Recovery = false;
+    bool EmitPartial = false;
 
-    FILE* file = fopen(argv[1], "rb");
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--follow") == 0) {
+            Follow = true;
+        }
+        else if (strcmp(argv[i], "--recovery") == 0) {
+            Recovery = true;
+        }
+        else if (strcmp(argv[i], "--emit-partial") == 0) {
+            EmitPartial = true;
+        }
+        else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            CheckpointPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            ReplayDestination = argv[++i];
+        }
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            ReplayRate = atof(argv[++i]);
+        }
+        else if (!InputPath && argv[i][0] != '-') {
+            InputPath = argv[i];
+        }
+        else {
+            xPrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    // replay sends the capture as is - analysis options do not apply
+    if (!InputPath || (ReplayDestination && (Follow || Recovery || EmitPartial || !CheckpointPath.empty()))) {
+        xPrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* file = fopen(InputPath, "rb");
 
     if (!file)
     {
@@ -18,36 +160,107 @@ int main(int argc, char* argv[], char* envp[])
         return EXIT_FAILURE;
     }
 
-    xTS_PacketHeader    TS_PacketHeader;
+    if (ReplayDestination) {
+        xTS_Replayer Replayer;
+        if (!Replayer.Init(ReplayDestination, ReplayRate)) {
+            fclose(file);
+            return EXIT_FAILURE;
+        }
+        bool Ok = Replayer.Run(file);
+        Replayer.PrintStatistics();
+        fclose(file);
+        return Ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-    int32_t TS_PacketId = 0;
+    xTS_PacketHeader    TS_PacketHeader;
 
     const int32_t PacketSize = xTS::TS_PacketLength;
 
     uint8_t PacketBuffer[PacketSize];
 
+    xParserState State;
+    const bool HasCheckpoint = !CheckpointPath.empty() && std::filesystem::exists(CheckpointPath);
+
+    xTS_ScramblingStatistics ScramblingStatistics;
+
     xPES_Assembler PES_Assembler;
-    PES_Assembler.Init(136);
+    PES_Assembler.Init(AnalyzedPID, HasCheckpoint);
+    PES_Assembler.setRecovery(Recovery, EmitPartial);
+
+    if (HasCheckpoint) {
+        if (!xLoadCheckpoint(CheckpointPath, State, PES_Assembler, ScramblingStatistics)) {
+            fprintf(stderr, "couldnt resume from checkpoint %s\n", CheckpointPath.c_str());
+            fclose(file);
+            return EXIT_FAILURE;
+        }
+        const char* Mismatch = xCheckInput(InputPath, file, State);
+        if (Mismatch || xFileSeek(file, (int64_t)State.ByteOffset) != 0) {
+            fprintf(stderr, "couldnt resume from checkpoint %s: %s\n", CheckpointPath.c_str(), Mismatch ? Mismatch : "seek failed");
+            fclose(file);
+            return EXIT_FAILURE;
+        }
+        fprintf(stderr, "Resuming at byte %" PRIu64 " (packet %" PRId64 ")\n", State.ByteOffset, State.TS_PacketId);
+    }
+
+    xTS_FileFollower Follower;
+    if (Follow) {
+        std::signal(SIGINT, xHandleStopSignal);
+        std::signal(SIGTERM, xHandleStopSignal);
+        if (!Follower.Init(InputPath)) {
+            fprintf(stderr, "file notifications unavailable, polling every %d ms\n", xTS_FileFollower::DefaultPollInterval_ms);
+        }
+    }
+
+    // checkpoint only new data, at most once per CheckpointInterval_ms (also while catching up)
+    uint64_t CheckpointOffset = State.ByteOffset;
+    std::chrono::steady_clock::time_point CheckpointTime = std::chrono::steady_clock::now();
+    auto xCheckpointIfDue = [&]() {
+        const auto Now = std::chrono::steady_clock::now();
+        if (CheckpointPath.empty() || State.ByteOffset == CheckpointOffset || Now - CheckpointTime < std::chrono::milliseconds(CheckpointInterval_ms)) return;
+        if (!xSaveCheckpoint(CheckpointPath, State, PES_Assembler, ScramblingStatistics)) {
+            fprintf(stderr, "couldnt write checkpoint %s\n", CheckpointPath.c_str());
+        }
+        CheckpointOffset = State.ByteOffset;
+        CheckpointTime = Now;
+    };
 
     //AF SECTION
     xTS_AdaptationField TS_AdaptationField;
-    int licznik = 0;
-    while (fread(PacketBuffer, 1, PacketSize, file) == PacketSize)
+    while (!StopRequested)
     {
+        size_t ReadSize = fread(PacketBuffer, 1, PacketSize, file);
+        if (ReadSize != PacketSize) {
+            // incomplete packet at end of growing file - read it again once it is complete
+            clearerr(file);
+            xFileSeek(file, (int64_t)State.ByteOffset);
+            if (!Follow) break;
+
+            xCheckpointIfDue();
+            fflush(stdout);
+            Follower.WaitForData(xTS_FileFollower::DefaultPollInterval_ms);
+            continue;
+        }
+
         TS_PacketHeader.Reset();
         if (TS_PacketHeader.Parse(PacketBuffer) == NOT_VALID) {
-            fprintf(stderr, "Invalid packet at ID: %d\n", TS_PacketId);
+            fprintf(stderr, "Invalid packet at ID: %" PRId64 "\n", State.TS_PacketId);
+        }
+        else {
+            // AF of every PID is needed - PCR drives the key switch timing
+            if (TS_PacketHeader.hasAdaptationField()) {
+                TS_AdaptationField.Reset();
+                TS_AdaptationField.Parse(PacketBuffer, TS_PacketHeader.getAFC());
+            }
+            ScramblingStatistics.AddPacket(&TS_PacketHeader, TS_PacketHeader.hasAdaptationField() ? &TS_AdaptationField : nullptr, State.TS_PacketId);
         }
 
 
 
-        if (TS_PacketHeader.getPID() == 136) {
-            printf("%010d ", TS_PacketId);
+        if (TS_PacketHeader.getPID() == AnalyzedPID) {
+            printf("%010" PRId64 " ", State.TS_PacketId);
             TS_PacketHeader.Print();
 
             if (TS_PacketHeader.hasAdaptationField()) {
-                TS_AdaptationField.Reset();
-                TS_AdaptationField.Parse(PacketBuffer, TS_PacketHeader.getAFC());
                 printf(" ");
                 TS_AdaptationField.Print();
             }
@@ -68,17 +281,60 @@ int main(int argc, char* argv[], char* envp[])
                 break;
             case xPES_Assembler::eResult::AssemblingFinished:
                 printf(" Finished PES: Len=%d", PES_Assembler.getNumPacketBytes());
+                if (PES_Assembler.isPartial()) {
+                    printf(" Partial: Gaps=%u Missing=%u FirstGap=%u", PES_Assembler.getNumGaps(),
+                        PES_Assembler.getNumMissingPackets(), PES_Assembler.getFirstGapOffset());
+                }
+                break;
+            case xPES_Assembler::eResult::PartialFinished:
+            case xPES_Assembler::eResult::PartialFinishedAndStarted:
+                printf(" Finished PES: Len=%d Partial: Gaps=%u Missing=%u FirstGap=%u", PES_Assembler.getNumPartialPacketBytes(),
+                    PES_Assembler.getPartialNumGaps(), PES_Assembler.getPartialNumMissingPackets(), PES_Assembler.getPartialFirstGapOffset());
+                if (result == xPES_Assembler::eResult::PartialFinishedAndStarted) {
+                    printf(" Started ");
+                    PES_Assembler.PrintPESH();
+                }
+                else {
+                    printf(" PcktLost");
+                }
+                break;
+            case xPES_Assembler::eResult::PayloadAfterEnd:
+                printf(" AfterEnd");
+                break;
+            case xPES_Assembler::eResult::AssemblingGap:
+                printf(" Gap: Missing=%u", PES_Assembler.getNumMissingPackets());
+                break;
+            case xPES_Assembler::eResult::DuplicateDropped:
+                printf(" Duplicate");
+                break;
+            case xPES_Assembler::eResult::ScrambledSkipped:
+                printf(" Scrambled");
                 break;
             default:
                 break;
             }
 
             printf("\n");
-            licznik++;
         }
 
-        TS_PacketId++;
+        if (State.ByteOffset == 0) {
+            memcpy(State.FirstPacket, PacketBuffer, PacketSize);
+        }
+        State.TS_PacketId++;
+        State.ByteOffset += PacketSize;
+
+        xCheckpointIfDue();
+
+    }
+
+    if (!CheckpointPath.empty() && !xSaveCheckpoint(CheckpointPath, State, PES_Assembler, ScramblingStatistics)) {
+        fprintf(stderr, "couldnt write checkpoint %s\n", CheckpointPath.c_str());
+    }
 
+    ScramblingStatistics.Print();
+    if (Recovery || EmitPartial) {
+        printf("Recovery: Duplicates=%" PRIu64 " ExcessDuplicates=%" PRIu64 " Discontinuities=%" PRIu64 "\n",
+            PES_Assembler.getNumDuplicates(), PES_Assembler.getNumExcessDuplicates(), PES_Assembler.getNumDiscontinuities());
     }
 
     fclose(file);
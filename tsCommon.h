@@ -4,6 +4,10 @@
 #include <cfloat>
 #include <climits>
 #include <cstddef>
+#include <cstdio>
+#if !defined(_MSC_VER)
+#include <sys/types.h>
+#endif
 
 #define NOT_VALID  -1
 
@@ -34,3 +38,14 @@ static inline  int64_t xSwapBytes64( int64_t Value) { return __builtin_bswap64(V
 #else
 #error Unrecognized compiler
 #endif
+
+//=============================================================================================================================================================================
+// 64-bit file positioning (long is 32 bit on some platforms)
+//=============================================================================================================================================================================
+#if defined(_MSC_VER)
+static inline int32_t xFileSeek(FILE* File, int64_t Offset, int32_t Origin = SEEK_SET) { return _fseeki64(File, Offset, Origin); }
+static inline int64_t xFileTell(FILE* File) { return _ftelli64(File); }
+#else
+static inline int32_t xFileSeek(FILE* File, int64_t Offset, int32_t Origin = SEEK_SET) { return fseeko(File, (off_t)Offset, Origin); }
+static inline int64_t xFileTell(FILE* File) { return (int64_t)ftello(File); }
+#endif
@@ -0,0 +1,74 @@
+#include "tsFileFollower.h"
+#include <chrono>
+#include <thread>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+//=============================================================================================================================================================================
+// xTS_FileFollower
+//=============================================================================================================================================================================
+
+xTS_FileFollower::xTS_FileFollower()
+{
+	m_NotifyFD = -1;
+	m_WatchFD = -1;
+}
+
+xTS_FileFollower::~xTS_FileFollower()
+{
+#if defined(__linux__)
+	if (m_NotifyFD >= 0) {
+		close(m_NotifyFD);
+	}
+#endif
+}
+
+/**
+@brief Start watching file for modifications
+@param FileName is path of followed file
+@return true if inotify watch was set up, false if polling will be used
+*/
+bool xTS_FileFollower::Init(const char* FileName)
+{
+#if defined(__linux__)
+	m_NotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_NotifyFD < 0) return false;
+
+	m_WatchFD = inotify_add_watch(m_NotifyFD, FileName, IN_MODIFY | IN_CLOSE_WRITE);
+	if (m_WatchFD < 0) {
+		close(m_NotifyFD);
+		m_NotifyFD = -1;
+		return false;
+	}
+	return true;
+#else
+	(void)FileName;
+	return false;
+#endif
+}
+
+/**
+@brief Block until followed file was modified or timeout expired
+@param Timeout_ms is maximum waiting time (also used as polling interval)
+*/
+void xTS_FileFollower::WaitForData(int32_t Timeout_ms)
+{
+#if defined(__linux__)
+	if (m_WatchFD >= 0) {
+		pollfd PollFD = { m_NotifyFD, POLLIN, 0 };
+		if (poll(&PollFD, 1, Timeout_ms) > 0) {
+			// drain pending events - we only care that something happened
+			alignas(inotify_event) char Events[4096];
+			while (read(m_NotifyFD, Events, sizeof(Events)) > 0) {}
+		}
+		return;
+	}
+#endif
+	std::this_thread::sleep_for(std::chrono::milliseconds(Timeout_ms));
+}
+
+//=============================================================================================================================================================================
@@ -0,0 +1,31 @@
+#pragma once
+#include "tsCommon.h"
+
+/*
+Waits for growth of a file which is still being written (e.g. by a recorder).
+On Linux inotify is used, on other platforms (or when inotify is unavailable)
+it falls back to plain polling.
+*/
+
+//=============================================================================================================================================================================
+
+class xTS_FileFollower
+{
+public:
+    static constexpr int32_t DefaultPollInterval_ms = 200;
+
+protected:
+    int32_t m_NotifyFD;
+    int32_t m_WatchFD;
+
+public:
+    xTS_FileFollower();
+    ~xTS_FileFollower();
+    bool Init(const char* FileName);
+    void WaitForData(int32_t Timeout_ms);
+
+public:
+    bool usesNotify() const { return m_WatchFD >= 0; }
+};
+
+//=============================================================================================================================================================================
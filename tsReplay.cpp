@@ -0,0 +1,293 @@
+#include "tsReplay.h"
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+//=============================================================================================================================================================================
+// xTS_Replayer
+//=============================================================================================================================================================================
+
+xTS_Replayer::xTS_Replayer()
+{
+	m_Socket = -1;
+	m_RateMultiplier = 1.0;
+	m_PCR_PID = -1;
+	m_LastPCR = 0;
+	m_HasPCR = false;
+	m_StreamTicks = 0;
+	m_TicksPerPacket = 0;
+	m_NumBatched = 0;
+	m_StartTime = tClock::now();
+	for (xDatagram& Datagram : m_Batch) { Datagram.Length = 0; }
+	m_NumPackets = m_NumDatagrams = m_NumSyscalls = m_NumSendErrors = 0;
+	m_JitterMin_ns = INT64_MAX;
+	m_JitterMax_ns = INT64_MIN;
+	m_JitterAbsSum_ns = 0;
+}
+
+xTS_Replayer::~xTS_Replayer()
+{
+#if defined(__linux__)
+	if (m_Socket >= 0) {
+		close(m_Socket);
+	}
+#endif
+}
+
+/**
+@brief Open UDP socket connected to destination
+@param Destination is "host:port"
+@param RateMultiplier scales playback speed (1.0 = real time, 2.0 = twice as fast)
+@return true on success
+*/
+bool xTS_Replayer::Init(const char* Destination, double RateMultiplier)
+{
+	if (!(RateMultiplier > 0)) {
+		fprintf(stderr, "replay rate must be positive\n");
+		return false;
+	}
+	m_RateMultiplier = RateMultiplier;
+
+#if defined(__linux__)
+	const std::string Dst = Destination;
+	const size_t Colon = Dst.rfind(':');
+	if (Colon == std::string::npos) {
+		fprintf(stderr, "replay destination must be host:port\n");
+		return false;
+	}
+	const std::string Host = Dst.substr(0, Colon);
+	const std::string Port = Dst.substr(Colon + 1);
+
+	addrinfo Hints = {};
+	Hints.ai_family = AF_UNSPEC;
+	Hints.ai_socktype = SOCK_DGRAM;
+	addrinfo* Addresses = nullptr;
+	if (getaddrinfo(Host.c_str(), Port.c_str(), &Hints, &Addresses) != 0 || !Addresses) {
+		fprintf(stderr, "cannot resolve %s\n", Destination);
+		return false;
+	}
+
+	for (addrinfo* Address = Addresses; Address; Address = Address->ai_next) {
+		m_Socket = socket(Address->ai_family, Address->ai_socktype, Address->ai_protocol);
+		if (m_Socket < 0) continue;
+		if (connect(m_Socket, Address->ai_addr, Address->ai_addrlen) == 0) break;
+		close(m_Socket);
+		m_Socket = -1;
+	}
+	freeaddrinfo(Addresses);
+
+	if (m_Socket < 0) {
+		fprintf(stderr, "cannot connect UDP socket to %s\n", Destination);
+		return false;
+	}
+
+	int32_t SendBufferSize = 4 << 20;
+	setsockopt(m_Socket, SOL_SOCKET, SO_SNDBUF, &SendBufferSize, sizeof(SendBufferSize));
+	return true;
+#else
+	(void)Destination;
+	fprintf(stderr, "UDP replay is supported on Linux only\n");
+	return false;
+#endif
+}
+
+/**
+@brief Replay whole input at PCR pace
+@param Input is TS file positioned at packet boundary
+@return true if whole input was read
+*/
+bool xTS_Replayer::Run(FILE* Input)
+{
+	if (m_Socket < 0) return false;
+
+	std::vector<uint8_t> ReadBuffer(xTS::TS_PacketLength * 1024);
+	m_StartTime = tClock::now();
+
+	size_t ReadSize;
+	while ((ReadSize = fread(ReadBuffer.data(), 1, ReadBuffer.size(), Input)) >= xTS::TS_PacketLength) {
+		const size_t NumPackets = ReadSize / xTS::TS_PacketLength;
+		for (size_t i = 0; i < NumPackets; i++) {
+			xAbsorbPacket(ReadBuffer.data() + i * xTS::TS_PacketLength);
+		}
+		if (!m_HasPCR && m_Pending.size() / xTS::TS_PacketLength > MaxPacketsBeforePCR) break;
+	}
+
+	// without PCR there is no timeline - refuse to send at line rate
+	if (!m_HasPCR) {
+		fprintf(stderr, "no PCR found in %zu packets, cannot pace replay\n", m_Pending.size() / xTS::TS_PacketLength);
+		return false;
+	}
+
+	// tail after last PCR keeps the last known packet rate
+	xSchedulePending((int64_t)(m_TicksPerPacket * (m_Pending.size() / xTS::TS_PacketLength)));
+	if (m_Batch[m_NumBatched].Length > 0) {
+		m_NumBatched++;
+	}
+	xFlushBatch();
+
+	if (m_TicksPerPacket == 0) {
+		fprintf(stderr, "PID %d carries a single usable PCR only, capture was sent without pacing\n", m_PCR_PID);
+		return false;
+	}
+	return !ferror(Input);
+}
+
+/// @brief Print replay summary with pacing jitter against PCR derived deadlines
+void xTS_Replayer::PrintStatistics() const
+{
+	const double Duration_s = (double)xNow_ns() / 1e9;
+	const double Bitrate_Mbps = Duration_s > 0 ? (double)m_NumPackets * xTS::TS_PacketLength * 8 / Duration_s / 1e6 : 0;
+
+	printf("Replay: PCR_PID=%d Packets=%" PRIu64 " Datagrams=%" PRIu64 " Syscalls=%" PRIu64 " SendErrors=%" PRIu64 "\n",
+		m_PCR_PID, m_NumPackets, m_NumDatagrams, m_NumSyscalls, m_NumSendErrors);
+	printf("Replay: Duration=%.3lfs Bitrate=%.3lfMbit/s Rate=%.3lfx\n", Duration_s, Bitrate_Mbps, m_RateMultiplier);
+	if (m_NumDatagrams > 0) {
+		printf("Replay: Jitter min=%.1lfus max=%.1lfus mean|abs|=%.1lfus\n",
+			m_JitterMin_ns / 1e3, m_JitterMax_ns / 1e3, m_JitterAbsSum_ns / m_NumDatagrams / 1e3);
+	}
+}
+
+void xTS_Replayer::xAbsorbPacket(const uint8_t* Packet)
+{
+	m_Pending.insert(m_Pending.end(), Packet, Packet + xTS::TS_PacketLength);
+
+	xTS_PacketHeader PacketHeader;
+	PacketHeader.Reset();
+	if (PacketHeader.Parse(Packet) == NOT_VALID || !PacketHeader.hasAdaptationField() || Packet[4] == 0) return;
+
+	xTS_AdaptationField AdaptationField;
+	AdaptationField.Reset();
+	AdaptationField.Parse(Packet, PacketHeader.getAFC());
+	if (!AdaptationField.getPCRFlag()) return;
+
+	if (m_PCR_PID < 0) {
+		m_PCR_PID = PacketHeader.getPID();
+	}
+	if (PacketHeader.getPID() != m_PCR_PID) return;
+
+	const uint64_t PCR = AdaptationField.getPCR();
+	const int64_t NumPending = m_Pending.size() / xTS::TS_PacketLength;
+	int64_t IntervalTicks = 0;
+
+	if (m_HasPCR) {
+		const uint64_t Delta = (PCR + xTS::PCR_Modulus - m_LastPCR) % xTS::PCR_Modulus;
+		if (AdaptationField.getDiscontinuity() || Delta == 0 || Delta > MaxPCRGap) {
+			IntervalTicks = (int64_t)(m_TicksPerPacket * NumPending);
+		}
+		else {
+			IntervalTicks = (int64_t)Delta;
+			m_TicksPerPacket = (double)Delta / NumPending;
+		}
+	}
+	m_LastPCR = PCR;
+	m_HasPCR = true;
+
+	xSchedulePending(IntervalTicks);
+}
+
+/// @brief Spread pending packets evenly over IntervalTicks, last one lands on the interval end
+void xTS_Replayer::xSchedulePending(int64_t IntervalTicks)
+{
+	const int64_t NumPending = m_Pending.size() / xTS::TS_PacketLength;
+	for (int64_t i = 0; i < NumPending; i++) {
+		const int64_t Ticks = m_StreamTicks + IntervalTicks * (i + 1) / NumPending;
+		xAppendPacket(m_Pending.data() + i * xTS::TS_PacketLength, Ticks);
+	}
+	m_StreamTicks += IntervalTicks;
+	m_Pending.clear();
+}
+
+void xTS_Replayer::xAppendPacket(const uint8_t* Packet, int64_t Ticks)
+{
+	xDatagram* Datagram = &m_Batch[m_NumBatched];
+
+	if (Datagram->Length == 0) {
+		const int64_t Deadline_ns = (int64_t)((double)Ticks * (1e9 / xTS::ExtendedClockFrequency_Hz) / m_RateMultiplier);
+		if (m_NumBatched > 0 && Deadline_ns - m_Batch[0].Deadline_ns > MaxBatchSpan_ns) {
+			xFlushBatch();
+			Datagram = &m_Batch[0];
+		}
+		Datagram->Deadline_ns = Deadline_ns;
+	}
+
+	memcpy(Datagram->Data + Datagram->Length, Packet, xTS::TS_PacketLength);
+	Datagram->Length += xTS::TS_PacketLength;
+	m_NumPackets++;
+
+	if (Datagram->Length == DatagramLength) {
+		m_NumBatched++;
+		if (m_NumBatched == MaxDatagramsPerBatch) {
+			xFlushBatch();
+		}
+	}
+}
+
+/// @brief Wait for deadline of the first batched datagram and send whole batch
+void xTS_Replayer::xFlushBatch()
+{
+	if (m_NumBatched == 0) return;
+
+	xWaitUntil(m_Batch[0].Deadline_ns);
+	const int64_t SendTime_ns = xNow_ns();
+
+#if defined(__linux__)
+	iovec    Vectors[MaxDatagramsPerBatch];
+	mmsghdr  Messages[MaxDatagramsPerBatch];
+	memset(Messages, 0, sizeof(Messages));
+	for (int32_t i = 0; i < m_NumBatched; i++) {
+		Vectors[i].iov_base = m_Batch[i].Data;
+		Vectors[i].iov_len = m_Batch[i].Length;
+		Messages[i].msg_hdr.msg_iov = &Vectors[i];
+		Messages[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int32_t NumSent = 0;
+	while (NumSent < m_NumBatched) {
+		const int32_t Result = sendmmsg(m_Socket, Messages + NumSent, m_NumBatched - NumSent, 0);
+		m_NumSyscalls++;
+		if (Result > 0) {
+			NumSent += Result;
+		}
+		else if (errno != EINTR) {
+			// e.g. ECONNREFUSED when nobody listens - drop the datagram and keep pacing
+			m_NumSendErrors++;
+			NumSent++;
+		}
+	}
+#endif
+
+	for (int32_t i = 0; i < m_NumBatched; i++) {
+		const int64_t Jitter_ns = SendTime_ns - m_Batch[i].Deadline_ns;
+		if (Jitter_ns < m_JitterMin_ns) m_JitterMin_ns = Jitter_ns;
+		if (Jitter_ns > m_JitterMax_ns) m_JitterMax_ns = Jitter_ns;
+		m_JitterAbsSum_ns += Jitter_ns < 0 ? -Jitter_ns : Jitter_ns;
+		m_Batch[i].Length = 0;
+	}
+	m_NumDatagrams += m_NumBatched;
+	m_NumBatched = 0;
+}
+
+/// @brief Sleep until shortly before deadline, then spin for the rest
+void xTS_Replayer::xWaitUntil(int64_t Deadline_ns) const
+{
+	const int64_t Remaining_ns = Deadline_ns - xNow_ns();
+	if (Remaining_ns > SpinThreshold_ns) {
+		std::this_thread::sleep_for(std::chrono::nanoseconds(Remaining_ns - SpinThreshold_ns));
+	}
+	while (xNow_ns() < Deadline_ns) {}
+}
+
+int64_t xTS_Replayer::xNow_ns() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(tClock::now() - m_StartTime).count();
+}
+
+//=============================================================================================================================================================================
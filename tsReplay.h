@@ -0,0 +1,80 @@
+#pragma once
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+/*
+Real-time replay of a TS capture to UDP.
+
+Packets are timestamped by linear interpolation between consecutive PCRs of the
+first PID carrying PCR. 7 TS packets are grouped into one UDP datagram (1316 bytes)
+and datagrams due within a short window are sent with a single sendmmsg() call.
+Sending is paced by std::chrono::steady_clock: sleep until shortly before the
+deadline, then spin. Linux only (sendmmsg).
+*/
+
+//=============================================================================================================================================================================
+
+class xTS_Replayer
+{
+public:
+    static constexpr int32_t  PacketsPerDatagram = 7;
+    static constexpr int32_t  DatagramLength = PacketsPerDatagram * xTS::TS_PacketLength;
+    static constexpr int32_t  MaxDatagramsPerBatch = 64;
+    static constexpr int64_t  MaxBatchSpan_ns = 500000;      // datagrams due within this window go out in one syscall
+    static constexpr int64_t  SpinThreshold_ns = 200000;     // busy-wait for the last part of every wait
+    static constexpr uint64_t MaxPCRGap = xTS::ExtendedClockFrequency_Hz; // larger PCR jump is treated as discontinuity
+    static constexpr int32_t  MaxPacketsBeforePCR = 100000;  // give up if no PCR shows up within this many packets
+
+    using tClock = std::chrono::steady_clock;
+
+protected:
+    struct xDatagram
+    {
+        uint8_t  Data[DatagramLength];
+        int32_t  Length;
+        int64_t  Deadline_ns;       // relative to replay start, already scaled by rate
+    };
+
+    //setup
+    int32_t m_Socket;
+    double  m_RateMultiplier;
+    //PCR timeline
+    int32_t  m_PCR_PID;
+    uint64_t m_LastPCR;
+    bool     m_HasPCR;
+    int64_t  m_StreamTicks;           // 27MHz ticks since first PCR, unwrapped
+    double   m_TicksPerPacket;        // from last valid PCR interval, used over discontinuities
+    std::vector<uint8_t> m_Pending;   // packets waiting for next PCR
+    //output
+    xDatagram m_Batch[MaxDatagramsPerBatch];
+    int32_t   m_NumBatched;
+    tClock::time_point m_StartTime;
+    //statistics
+    uint64_t m_NumPackets;
+    uint64_t m_NumDatagrams;
+    uint64_t m_NumSyscalls;
+    uint64_t m_NumSendErrors;
+    int64_t  m_JitterMin_ns;
+    int64_t  m_JitterMax_ns;
+    double   m_JitterAbsSum_ns;
+
+public:
+    xTS_Replayer();
+    ~xTS_Replayer();
+    bool Init(const char* Destination, double RateMultiplier);
+    bool Run(FILE* Input);
+    void PrintStatistics() const;
+
+protected:
+    void xAbsorbPacket(const uint8_t* Packet);
+    void xSchedulePending(int64_t IntervalTicks);
+    void xAppendPacket(const uint8_t* Packet, int64_t Ticks);
+    void xFlushBatch();
+    void xWaitUntil(int64_t Deadline_ns) const;
+    int64_t xNow_ns() const;
+};
+
+//=============================================================================================================================================================================
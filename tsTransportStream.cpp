@@ -89,10 +89,10 @@ int32_t xTS_AdaptationField::Parse(const uint8_t* PacketBuffer, uint8_t Adaptati
 	uint8_t offset = 6;
 
 	if (m_PCR_flag == 1) {
-		PCR_base = PCR_base | (PacketBuffer[offset] << 25);
-		PCR_base = PCR_base | (PacketBuffer[offset + 1] << 17);
-		PCR_base = PCR_base | (PacketBuffer[offset + 2] << 9);
-		PCR_base = PCR_base | (PacketBuffer[offset + 3] << 1);
+		PCR_base = PCR_base | ((uint64_t)PacketBuffer[offset] << 25);
+		PCR_base = PCR_base | ((uint64_t)PacketBuffer[offset + 1] << 17);
+		PCR_base = PCR_base | ((uint64_t)PacketBuffer[offset + 2] << 9);
+		PCR_base = PCR_base | ((uint64_t)PacketBuffer[offset + 3] << 1);
 		PCR_base = PCR_base | ((PacketBuffer[offset + 4] >> 7) & 0b1);
 
 		PCR_extension = (PacketBuffer[offset + 4] & 0b1) << 8;
@@ -104,10 +104,10 @@ int32_t xTS_AdaptationField::Parse(const uint8_t* PacketBuffer, uint8_t Adaptati
 	}
 
 	if (m_OPCR_flag == 1) {
-		OPCR_base = OPCR_base | (PacketBuffer[offset] << 25);
-		OPCR_base = OPCR_base | (PacketBuffer[offset + 1] << 17);
-		OPCR_base = OPCR_base | (PacketBuffer[offset + 2] << 9);
-		OPCR_base = OPCR_base | (PacketBuffer[offset + 3] << 1);
+		OPCR_base = OPCR_base | ((uint64_t)PacketBuffer[offset] << 25);
+		OPCR_base = OPCR_base | ((uint64_t)PacketBuffer[offset + 1] << 17);
+		OPCR_base = OPCR_base | ((uint64_t)PacketBuffer[offset + 2] << 9);
+		OPCR_base = OPCR_base | ((uint64_t)PacketBuffer[offset + 3] << 1);
 		OPCR_base = OPCR_base | ((PacketBuffer[offset + 4] >> 7) & 0b1);
 
 		OPCR_extension = (PacketBuffer[offset + 4] & 0b1) << 8;
@@ -146,12 +146,12 @@ void xTS_AdaptationField::Print() const
 
 	if (m_PCR_flag == 1) {
 		double PCR_time = (double)PCR / xTS::ExtendedClockFrequency_Hz;
-		printf(" PCR=%08u (Time=%.6lfs)", PCR, PCR_time);
+		printf(" PCR=%08" PRIu64 " (Time=%.6lfs)", PCR, PCR_time);
 	}
 
 	if (m_OPCR_flag == 1) {
 		double OPCR_time = (double)OPCR / xTS::ExtendedClockFrequency_Hz;
-		printf(" OPCR=%08X (Time=%.6lfs)", OPCR, OPCR_time);
+		printf(" OPCR=%08" PRIX64 " (Time=%.6lfs)", OPCR, OPCR_time);
 	}
 
 	if (StuffingBytes > 0) {
@@ -229,6 +229,24 @@ int32_t xPES_PacketHeader::getHeaderLength() const
 	return 9 + m_PES_header_data_length; // 6 + 3 + dlugosc dodatkowych danych
 }
 
+/// @brief Write PES header fields to checkpoint file (host byte order)
+bool xPES_PacketHeader::SaveState(FILE* File) const
+{
+	return fwrite(&m_PacketStartCodePrefix, sizeof(m_PacketStartCodePrefix), 1, File) == 1 &&
+		fwrite(&m_StreamId, sizeof(m_StreamId), 1, File) == 1 &&
+		fwrite(&m_PacketLength, sizeof(m_PacketLength), 1, File) == 1 &&
+		fwrite(&m_PES_header_data_length, sizeof(m_PES_header_data_length), 1, File) == 1;
+}
+
+/// @brief Read PES header fields written by SaveState
+bool xPES_PacketHeader::LoadState(FILE* File)
+{
+	return fread(&m_PacketStartCodePrefix, sizeof(m_PacketStartCodePrefix), 1, File) == 1 &&
+		fread(&m_StreamId, sizeof(m_StreamId), 1, File) == 1 &&
+		fread(&m_PacketLength, sizeof(m_PacketLength), 1, File) == 1 &&
+		fread(&m_PES_header_data_length, sizeof(m_PES_header_data_length), 1, File) == 1;
+}
+
 void xPES_PacketHeader::Print() const
 {
 	printf("PES: PSCP=%d SID=%d L=%d",
@@ -247,8 +265,25 @@ xPES_Assembler::xPES_Assembler()
 	m_Buffer = nullptr;
 	m_BufferSize = 0;
 	m_DataOffset = 0;
+	m_PartialBuffer = nullptr;
+	m_PartialDataOffset = 0;
 	m_LastContinuityCounter = -1;
 	m_Started = false;
+	m_Finished = false;
+	m_RecoveryMode = false;
+	m_EmitPartial = false;
+	m_DuplicateSeen = false;
+	m_PendingDiscontinuity = false;
+	m_LastWasStart = false;
+	m_NumGaps = 0;
+	m_NumMissingPackets = 0;
+	m_FirstGapOffset = 0;
+	m_PartialNumGaps = 0;
+	m_PartialNumMissingPackets = 0;
+	m_PartialFirstGapOffset = 0;
+	m_NumDuplicates = 0;
+	m_NumExcessDuplicates = 0;
+	m_NumDiscontinuities = 0;
 	m_OutputFile = nullptr;
 }
 
@@ -257,21 +292,33 @@ xPES_Assembler::~xPES_Assembler()
 	if (m_Buffer) {
 		delete[] m_Buffer;
 	}
+	if (m_PartialBuffer) {
+		delete[] m_PartialBuffer;
+	}
 	if (m_OutputFile) {
 		fclose(m_OutputFile);
 	}
 }
 
-void xPES_Assembler::Init(int32_t PID)
+/**
+@brief Setup assembler for given PID
+@param PID is PID of assembled elementary stream
+@param Resume keeps existing output file (position is restored by LoadState)
+*/
+void xPES_Assembler::Init(int32_t PID, bool Resume)
 {
 	m_PID = PID;
 	m_BufferSize = 65536; // 64KB na pakiet PES bo 2^16
 	m_Buffer = new uint8_t[m_BufferSize];
+	m_PartialBuffer = new uint8_t[m_BufferSize];
 	xBufferReset();
 
 	char filename[256];
 	sprintf(filename, "PID%d.mp2", PID);
-	m_OutputFile = fopen(filename, "wb");
+	m_OutputFile = Resume ? fopen(filename, "r+b") : nullptr;
+	if (!m_OutputFile) {
+		m_OutputFile = fopen(filename, "wb");
+	}
 	if (!m_OutputFile) {
 		printf("Error: Cannot create output file %s\n", filename);
 	}
@@ -280,11 +327,102 @@ void xPES_Assembler::Init(int32_t PID)
 	}
 }
 
+/**
+@brief Write assembler state (PES header, partial buffer, CC, output position) to checkpoint file
+@return true on success
+*/
+bool xPES_Assembler::SaveState(FILE* File) const
+{
+	uint8_t Started = m_Started ? 1 : 0;
+	uint8_t Finished = m_Finished ? 1 : 0;
+	uint8_t DuplicateSeen = m_DuplicateSeen ? 1 : 0;
+	uint8_t PendingDiscontinuity = m_PendingDiscontinuity ? 1 : 0;
+	uint8_t LastWasStart = m_LastWasStart ? 1 : 0;
+	int64_t OutputOffset = m_OutputFile ? xFileTell(m_OutputFile) : 0;
+
+	return fwrite(&m_PID, sizeof(m_PID), 1, File) == 1 &&
+		fwrite(&m_DataOffset, sizeof(m_DataOffset), 1, File) == 1 &&
+		fwrite(&m_LastContinuityCounter, sizeof(m_LastContinuityCounter), 1, File) == 1 &&
+		fwrite(&Started, sizeof(Started), 1, File) == 1 &&
+		fwrite(&Finished, sizeof(Finished), 1, File) == 1 &&
+		fwrite(&OutputOffset, sizeof(OutputOffset), 1, File) == 1 &&
+		fwrite(&DuplicateSeen, sizeof(DuplicateSeen), 1, File) == 1 &&
+		fwrite(&PendingDiscontinuity, sizeof(PendingDiscontinuity), 1, File) == 1 &&
+		fwrite(&LastWasStart, sizeof(LastWasStart), 1, File) == 1 &&
+		fwrite(&m_NumGaps, sizeof(m_NumGaps), 1, File) == 1 &&
+		fwrite(&m_NumMissingPackets, sizeof(m_NumMissingPackets), 1, File) == 1 &&
+		fwrite(&m_FirstGapOffset, sizeof(m_FirstGapOffset), 1, File) == 1 &&
+		fwrite(&m_NumDuplicates, sizeof(m_NumDuplicates), 1, File) == 1 &&
+		fwrite(&m_NumExcessDuplicates, sizeof(m_NumExcessDuplicates), 1, File) == 1 &&
+		fwrite(&m_NumDiscontinuities, sizeof(m_NumDiscontinuities), 1, File) == 1 &&
+		m_PESH.SaveState(File) &&
+		fwrite(m_Buffer, 1, m_DataOffset, File) == m_DataOffset;
+}
+
+/**
+@brief Restore assembler state written by SaveState (Init must be called first)
+@return true on success, false if checkpoint is broken or belongs to other PID
+*/
+bool xPES_Assembler::LoadState(FILE* File)
+{
+	int32_t PID = 0;
+	uint32_t DataOffset = 0;
+	int8_t LastContinuityCounter = -1;
+	uint8_t Started = 0;
+	uint8_t Finished = 0;
+	uint8_t DuplicateSeen = 0;
+	uint8_t PendingDiscontinuity = 0;
+	uint8_t LastWasStart = 0;
+	int64_t OutputOffset = 0;
+
+	if (fread(&PID, sizeof(PID), 1, File) != 1 ||
+		fread(&DataOffset, sizeof(DataOffset), 1, File) != 1 ||
+		fread(&LastContinuityCounter, sizeof(LastContinuityCounter), 1, File) != 1 ||
+		fread(&Started, sizeof(Started), 1, File) != 1 ||
+		fread(&Finished, sizeof(Finished), 1, File) != 1 ||
+		fread(&OutputOffset, sizeof(OutputOffset), 1, File) != 1 ||
+		fread(&DuplicateSeen, sizeof(DuplicateSeen), 1, File) != 1 ||
+		fread(&PendingDiscontinuity, sizeof(PendingDiscontinuity), 1, File) != 1 ||
+		fread(&LastWasStart, sizeof(LastWasStart), 1, File) != 1 ||
+		fread(&m_NumGaps, sizeof(m_NumGaps), 1, File) != 1 ||
+		fread(&m_NumMissingPackets, sizeof(m_NumMissingPackets), 1, File) != 1 ||
+		fread(&m_FirstGapOffset, sizeof(m_FirstGapOffset), 1, File) != 1 ||
+		fread(&m_NumDuplicates, sizeof(m_NumDuplicates), 1, File) != 1 ||
+		fread(&m_NumExcessDuplicates, sizeof(m_NumExcessDuplicates), 1, File) != 1 ||
+		fread(&m_NumDiscontinuities, sizeof(m_NumDiscontinuities), 1, File) != 1) {
+		return false;
+	}
+	if (PID != m_PID || DataOffset > m_BufferSize) return false;
+	if (!m_PESH.LoadState(File)) return false;
+	if (fread(m_Buffer, 1, DataOffset, File) != DataOffset) return false;
+
+	m_DataOffset = DataOffset;
+	m_LastContinuityCounter = LastContinuityCounter;
+	m_Started = Started != 0;
+	m_Finished = Finished != 0;
+	m_DuplicateSeen = DuplicateSeen != 0;
+	m_PendingDiscontinuity = PendingDiscontinuity != 0;
+	m_LastWasStart = LastWasStart != 0;
+
+	// output file must still hold everything written before the checkpoint,
+	// data written after the checkpoint will be overwritten
+	if (!m_OutputFile || xFileSeek(m_OutputFile, 0, SEEK_END) != 0) return false;
+	if (xFileTell(m_OutputFile) < OutputOffset) return false;
+	return xFileSeek(m_OutputFile, OutputOffset) == 0;
+}
+
 void xPES_Assembler::xBufferReset()
 {
 	m_DataOffset = 0;
 	m_Started = false;
 	m_LastContinuityCounter = -1;
+	m_Finished = false;
+	m_DuplicateSeen = false;
+	m_PendingDiscontinuity = false;
+	m_LastWasStart = false;
+	m_NumGaps = 0;
+	m_NumMissingPackets = 0;
+	m_FirstGapOffset = 0;
 }
 
 void xPES_Assembler::xBufferAppend(const uint8_t* Data, int32_t Size)
@@ -322,19 +460,78 @@ xPES_Assembler::eResult xPES_Assembler::AbsorbPacket(const uint8_t* TransportStr
 		return eResult::UnexpectedPID;
 	}
 
+	// Payload zaszyfrowany - nie ma sensu szukac naglowka PES, biezacy PES jest stracony
+	if (PacketHeader->isScrambled()) {
+		if (m_Started) {
+			m_DataOffset = 0;
+			m_Started = false;
+			m_LastContinuityCounter = -1;
+		}
+		return eResult::ScrambledSkipped;
+	}
+
+	// nieciaglosc zasygnalizowana w pakiecie bez payloadu dotyczy nastepnego pakietu
+	const bool Discontinuity = m_PendingDiscontinuity ||
+		(PacketHeader->hasAdaptationField() && AdaptationField->getDiscontinuity());
+
+	if (m_RecoveryMode && m_Started) {
+		// pakiet bez payloadu nie zwieksza CC - to nie jest strata
+		if (!PacketHeader->hasPayload()) {
+			m_PendingDiscontinuity = Discontinuity;
+			return eResult::AssemblingContinue;
+		}
+		if (Discontinuity) {
+			// po nieciaglosci CC moze byc dowolny (nawet ten sam) - to nie jest duplikat
+			m_NumDiscontinuities++;
+		}
+		// standard pozwala na jeden duplikat (ten sam CC) - odrzuc go, kolejne powtorzenia tez (nigdy jako luka)
+		// PUSI po pakiecie bez PUSI (i odwrotnie) to inny pakiet, nie duplikat
+		else if (PacketHeader->getCC() == m_LastContinuityCounter && (PacketHeader->getS() != 0) == m_LastWasStart) {
+			if (m_DuplicateSeen) {
+				m_NumExcessDuplicates++;
+			}
+			else {
+				m_DuplicateSeen = true;
+				m_NumDuplicates++;
+			}
+			return eResult::DuplicateDropped;
+		}
+	}
+	m_DuplicateSeen = false;
+	m_PendingDiscontinuity = false;
+
 	// Obliczenie offsetu do payload
 	int32_t payloadOffset = calculatePayloadOffset(PacketHeader, AdaptationField);
 	int32_t payloadSize = xTS::TS_PacketLength - payloadOffset;
 
 	if (PacketHeader->getS()) { // Payload Unit Start Indicator = NOWY PAKIET PES
 
+		// poprzedni PES niedokonczony (nie osiagnal swojej dlugosci albo ma luki) - zglos go jako czesciowy
+		const bool ReportPartial = m_EmitPartial && m_Started && !m_Finished &&
+			(m_PESH.getPacketLength() > 0 || m_NumGaps > 0);
+		if (ReportPartial) {
+			int8_t expectedCC = (m_LastContinuityCounter + 1) % 16;
+			if (m_NumGaps == 0) m_FirstGapOffset = m_DataOffset;
+			m_NumGaps++;
+			if (!Discontinuity) {
+				m_NumMissingPackets += (PacketHeader->getCC() - expectedCC + 16) % 16;
+			}
+			uint8_t* Buffer = m_PartialBuffer;
+			m_PartialBuffer = m_Buffer;
+			m_Buffer = Buffer;
+			m_PartialDataOffset = m_DataOffset;
+			m_PartialNumGaps = m_NumGaps;
+			m_PartialNumMissingPackets = m_NumMissingPackets;
+			m_PartialFirstGapOffset = m_FirstGapOffset;
+		}
+
 		// NOWY PAKIET PES - resetuj wszystko
 		m_PESH.Reset();
 		if (m_PESH.Parse(TransportStreamPacket + payloadOffset, payloadSize) == NOT_VALID) {
 			m_DataOffset = 0;
 			m_Started = false;
 			m_LastContinuityCounter = -1;
-			return eResult::StreamPackedLost;
+			return ReportPartial ? eResult::PartialFinished : eResult::StreamPackedLost;
 		}
 
 		payloadSize = payloadSize - m_PESH.getHeaderLength();
@@ -342,22 +539,37 @@ xPES_Assembler::eResult xPES_Assembler::AbsorbPacket(const uint8_t* TransportStr
 		// Reset bufora, ale ZACHOWAJ CC
 		m_DataOffset = 0;
 		m_Started = true;
+		m_Finished = false;
+		m_NumGaps = 0;
+		m_NumMissingPackets = 0;
+		m_FirstGapOffset = 0;
 		m_LastContinuityCounter = PacketHeader->getCC();
+		m_LastWasStart = true;
 
 		xBufferAppend(TransportStreamPacket + payloadOffset + m_PESH.getHeaderLength(), payloadSize);
 
-		return eResult::AssemblingStarted;
+		return ReportPartial ? eResult::PartialFinishedAndStarted : eResult::AssemblingStarted;
 	}
 	else { // KONTYNUACJA PAKIETU PES
 
 		// Sprawdzenie czy started i CC
+		bool Gap = false;
 		if (m_Started) {
 			int8_t expectedCC = (m_LastContinuityCounter + 1) % 16;
-			if (PacketHeader->getCC() != expectedCC) {
-				m_DataOffset = 0;
-				m_Started = false;
-				m_LastContinuityCounter = -1;
-				return eResult::StreamPackedLost;
+			// zasygnalizowana nieciaglosc (tryb recovery) - nowy CC jest poprawny
+			if (PacketHeader->getCC() != expectedCC && !(m_RecoveryMode && Discontinuity)) {
+				if (m_EmitPartial) {
+					if (m_NumGaps == 0) m_FirstGapOffset = m_DataOffset;
+					m_NumGaps++;
+					m_NumMissingPackets += (PacketHeader->getCC() - expectedCC + 16) % 16;
+					Gap = true;
+				}
+				else {
+					m_DataOffset = 0;
+					m_Started = false;
+					m_LastContinuityCounter = -1;
+					return eResult::StreamPackedLost;
+				}
 			}
 		}
 		else {
@@ -365,16 +577,211 @@ xPES_Assembler::eResult xPES_Assembler::AbsorbPacket(const uint8_t* TransportStr
 		}
 
 		m_LastContinuityCounter = PacketHeader->getCC();
+		m_LastWasStart = false;
+
+		// PES juz zakonczony - dane poza jego dlugoscia nie naleza do niego
+		if (m_Finished && m_RecoveryMode) {
+			return eResult::PayloadAfterEnd;
+		}
 		xBufferAppend(TransportStreamPacket + payloadOffset, payloadSize);
 
 		// Sprawdzenie kompletnoci
 		if (m_PESH.getPacketLength() > 0) {
 			int32_t expectedTotalLength = m_PESH.getPacketLength() - (m_PESH.getHeaderLength() - 6);
-			if (m_DataOffset >= expectedTotalLength) {
+			// PES z lukami nie osiagnie swojej dlugosci - zostanie zgloszony jako czesciowy przy nastepnym PUSI
+			if (m_NumGaps == 0 && (int64_t)m_DataOffset >= expectedTotalLength) {
+				m_Finished = true;
 				return eResult::AssemblingFinished;
 			}
 		}
 
-		return eResult::AssemblingContinue;
+		return Gap ? eResult::AssemblingGap : eResult::AssemblingContinue;
 	}
-}
\ No newline at end of file
+}
+
+//=============================================================================================================================================================================
+// xTS_ScramblingStatistics
+//=============================================================================================================================================================================
+
+xTS_ScramblingStatistics::xTS_ScramblingStatistics()
+{
+	m_PIDs = new xPIDStatistics[NumPIDs];
+	Reset();
+}
+
+xTS_ScramblingStatistics::~xTS_ScramblingStatistics()
+{
+	delete[] m_PIDs;
+}
+
+void xTS_ScramblingStatistics::Reset()
+{
+	for (int32_t PID = 0; PID < NumPIDs; PID++) {
+		xPIDStatistics& Stats = m_PIDs[PID];
+		Stats.NumPackets = 0;
+		Stats.NumScrambled = 0;
+		Stats.NumKeySwitches = 0;
+		Stats.LastTSC = (uint8_t)xTS_PacketHeader::eTSC::NotScrambled;
+		Stats.LastSwitchPacketId = -1;
+		Stats.MinSwitchInterval = INT64_MAX;
+		Stats.MaxSwitchInterval = 0;
+		Stats.LastSwitchTime = -1;
+		Stats.MinSwitchDuration = INT64_MAX;
+		Stats.MaxSwitchDuration = 0;
+	}
+	m_PCR_PID = -1;
+	m_LastPCR = 0;
+	m_StreamTime = -1;
+}
+
+/**
+@brief Count packet and detect even/odd key switch on its PID
+@param PacketHeader is parsed header of the packet
+@param AdaptationField is parsed adaptation field of the packet or nullptr (used for PCR stream clock)
+@param PacketId is index of the packet in stream
+*/
+void xTS_ScramblingStatistics::AddPacket(const xTS_PacketHeader* PacketHeader, const xTS_AdaptationField* AdaptationField, int64_t PacketId)
+{
+	xUpdateClock(PacketHeader, AdaptationField);
+
+	xPIDStatistics& Stats = m_PIDs[PacketHeader->getPID()];
+	const uint8_t TSC = PacketHeader->getTSC();
+
+	Stats.NumPackets++;
+	if (TSC == (uint8_t)xTS_PacketHeader::eTSC::NotScrambled) return;
+	Stats.NumScrambled++;
+
+	// zmiana klucza: parzysty <-> nieparzysty (przejscia z/do clear nie licza sie)
+	const bool KeySwitch = Stats.LastTSC != TSC &&
+		Stats.LastTSC >= (uint8_t)xTS_PacketHeader::eTSC::EvenKey &&
+		TSC >= (uint8_t)xTS_PacketHeader::eTSC::EvenKey;
+	if (KeySwitch) {
+		if (Stats.LastSwitchPacketId >= 0) {
+			const int64_t Interval = PacketId - Stats.LastSwitchPacketId;
+			if (Interval < Stats.MinSwitchInterval) Stats.MinSwitchInterval = Interval;
+			if (Interval > Stats.MaxSwitchInterval) Stats.MaxSwitchInterval = Interval;
+		}
+		if (Stats.LastSwitchTime >= 0 && m_StreamTime >= 0) {
+			const int64_t Duration = m_StreamTime - Stats.LastSwitchTime;
+			if (Duration < Stats.MinSwitchDuration) Stats.MinSwitchDuration = Duration;
+			if (Duration > Stats.MaxSwitchDuration) Stats.MaxSwitchDuration = Duration;
+		}
+		Stats.NumKeySwitches++;
+		Stats.LastSwitchPacketId = PacketId;
+		Stats.LastSwitchTime = m_StreamTime;
+	}
+	Stats.LastTSC = TSC;
+}
+
+/// @brief Advance stream clock on PCR of the first PID carrying PCR (resolution = PCR interval)
+void xTS_ScramblingStatistics::xUpdateClock(const xTS_PacketHeader* PacketHeader, const xTS_AdaptationField* AdaptationField)
+{
+	if (!AdaptationField || AdaptationField->getAdaptationFieldLength() == 0 || !AdaptationField->getPCRFlag()) return;
+
+	if (m_PCR_PID < 0) {
+		m_PCR_PID = PacketHeader->getPID();
+	}
+	if (PacketHeader->getPID() != m_PCR_PID) return;
+
+	const uint64_t PCR = AdaptationField->getPCR();
+	if (m_StreamTime < 0) {
+		m_StreamTime = 0;
+	}
+	else if (!AdaptationField->getDiscontinuity()) {
+		// po nieciaglosci zegar stoi w miejscu - nowa podstawa czasu
+		m_StreamTime += (int64_t)((PCR + xTS::PCR_Modulus - m_LastPCR) % xTS::PCR_Modulus);
+	}
+	m_LastPCR = PCR;
+}
+
+/**
+@brief Write stream clock and records of PIDs seen so far to checkpoint file (host byte order)
+@return true on success
+*/
+bool xTS_ScramblingStatistics::SaveState(FILE* File) const
+{
+	uint32_t NumUsed = 0;
+	for (int32_t PID = 0; PID < NumPIDs; PID++) {
+		if (m_PIDs[PID].NumPackets > 0) NumUsed++;
+	}
+	if (fwrite(&m_PCR_PID, sizeof(m_PCR_PID), 1, File) != 1 ||
+		fwrite(&m_LastPCR, sizeof(m_LastPCR), 1, File) != 1 ||
+		fwrite(&m_StreamTime, sizeof(m_StreamTime), 1, File) != 1 ||
+		fwrite(&NumUsed, sizeof(NumUsed), 1, File) != 1) {
+		return false;
+	}
+
+	for (int32_t PID = 0; PID < NumPIDs; PID++) {
+		const xPIDStatistics& Stats = m_PIDs[PID];
+		if (Stats.NumPackets == 0) continue;
+		const uint16_t PID16 = (uint16_t)PID;
+		if (fwrite(&PID16, sizeof(PID16), 1, File) != 1 ||
+			fwrite(&Stats.NumPackets, sizeof(Stats.NumPackets), 1, File) != 1 ||
+			fwrite(&Stats.NumScrambled, sizeof(Stats.NumScrambled), 1, File) != 1 ||
+			fwrite(&Stats.NumKeySwitches, sizeof(Stats.NumKeySwitches), 1, File) != 1 ||
+			fwrite(&Stats.LastTSC, sizeof(Stats.LastTSC), 1, File) != 1 ||
+			fwrite(&Stats.LastSwitchPacketId, sizeof(Stats.LastSwitchPacketId), 1, File) != 1 ||
+			fwrite(&Stats.MinSwitchInterval, sizeof(Stats.MinSwitchInterval), 1, File) != 1 ||
+			fwrite(&Stats.MaxSwitchInterval, sizeof(Stats.MaxSwitchInterval), 1, File) != 1 ||
+			fwrite(&Stats.LastSwitchTime, sizeof(Stats.LastSwitchTime), 1, File) != 1 ||
+			fwrite(&Stats.MinSwitchDuration, sizeof(Stats.MinSwitchDuration), 1, File) != 1 ||
+			fwrite(&Stats.MaxSwitchDuration, sizeof(Stats.MaxSwitchDuration), 1, File) != 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/// @brief Replace clock and all records with those written by SaveState
+bool xTS_ScramblingStatistics::LoadState(FILE* File)
+{
+	Reset();
+
+	uint32_t NumUsed = 0;
+	if (fread(&m_PCR_PID, sizeof(m_PCR_PID), 1, File) != 1 ||
+		fread(&m_LastPCR, sizeof(m_LastPCR), 1, File) != 1 ||
+		fread(&m_StreamTime, sizeof(m_StreamTime), 1, File) != 1 ||
+		fread(&NumUsed, sizeof(NumUsed), 1, File) != 1 || NumUsed > NumPIDs) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < NumUsed; i++) {
+		uint16_t PID = 0;
+		if (fread(&PID, sizeof(PID), 1, File) != 1 || PID >= NumPIDs) return false;
+
+		xPIDStatistics& Stats = m_PIDs[PID];
+		if (fread(&Stats.NumPackets, sizeof(Stats.NumPackets), 1, File) != 1 ||
+			fread(&Stats.NumScrambled, sizeof(Stats.NumScrambled), 1, File) != 1 ||
+			fread(&Stats.NumKeySwitches, sizeof(Stats.NumKeySwitches), 1, File) != 1 ||
+			fread(&Stats.LastTSC, sizeof(Stats.LastTSC), 1, File) != 1 ||
+			fread(&Stats.LastSwitchPacketId, sizeof(Stats.LastSwitchPacketId), 1, File) != 1 ||
+			fread(&Stats.MinSwitchInterval, sizeof(Stats.MinSwitchInterval), 1, File) != 1 ||
+			fread(&Stats.MaxSwitchInterval, sizeof(Stats.MaxSwitchInterval), 1, File) != 1 ||
+			fread(&Stats.LastSwitchTime, sizeof(Stats.LastSwitchTime), 1, File) != 1 ||
+			fread(&Stats.MinSwitchDuration, sizeof(Stats.MinSwitchDuration), 1, File) != 1 ||
+			fread(&Stats.MaxSwitchDuration, sizeof(Stats.MaxSwitchDuration), 1, File) != 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/// @brief Print statistics of PIDs which carried at least one scrambled packet
+void xTS_ScramblingStatistics::Print() const
+{
+	for (int32_t PID = 0; PID < NumPIDs; PID++) {
+		const xPIDStatistics& Stats = m_PIDs[PID];
+		if (Stats.NumScrambled == 0) continue;
+
+		printf("PID=%4d Scrambled=%" PRIu64 "/%" PRIu64 " (%.2lf%%) KeySwitches=%u",
+			PID, Stats.NumScrambled, Stats.NumPackets, 100.0 * Stats.NumScrambled / Stats.NumPackets, Stats.NumKeySwitches);
+		if (Stats.MaxSwitchDuration > 0) {
+			printf(" SwitchInterval min=%.3lfs max=%.3lfs",
+				(double)Stats.MinSwitchDuration / xTS::ExtendedClockFrequency_Hz, (double)Stats.MaxSwitchDuration / xTS::ExtendedClockFrequency_Hz);
+		}
+		if (Stats.NumKeySwitches > 1) {
+			printf(" (min=%" PRId64 " max=%" PRId64 " pckts)", Stats.MinSwitchInterval, Stats.MaxSwitchInterval);
+		}
+		printf("\n");
+	}
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "tsCommon.h"
+#include <cstdio>
 #include <string>
 
 /*
@@ -48,6 +49,7 @@ public:
     static constexpr uint32_t BaseClockFrequency_kHz = 90; //kHz
     static constexpr uint32_t ExtendedClockFrequency_kHz = 27000; //kHz
     static constexpr uint32_t BaseToExtendedClockMultiplier = 300;
+    static constexpr uint64_t PCR_Modulus = (uint64_t(1) << 33) * BaseToExtendedClockMultiplier; //PCR wraps around after 2^33 base clock ticks
 };
 
 //=============================================================================================================================================================================
@@ -66,6 +68,14 @@ public:
         NuLL = 0x1FFF,
     };
 
+    enum class eTSC : uint8_t //DVB semantics
+    {
+        NotScrambled = 0,
+        Reserved = 1,
+        EvenKey = 2,
+        OddKey = 3,
+    };
+
 protected:
     uint8_t  m_SB;
     uint8_t m_E;
@@ -94,6 +104,7 @@ public:
 public:
     bool     hasAdaptationField() const { return (m_AFC == 2 || m_AFC == 3); };
     bool     hasPayload() const { return (m_AFC == 1 || m_AFC == 3); };
+    bool     isScrambled() const { return m_TSC != (uint8_t)eTSC::NotScrambled; };
 };
 
 class xTS_AdaptationField
@@ -112,17 +123,17 @@ protected:
     uint8_t m_AdaptationFieldExtensionFlag;
 
     uint64_t PCR_base;
-    uint8_t PCR_extension;
+    uint16_t PCR_extension;
 
     uint64_t OPCR_base;
-    uint8_t OPCR_extension;
+    uint16_t OPCR_extension;
 
     uint8_t SpliceCountDown;
     uint8_t TransportPrivateData;
     uint8_t StuffingBytes;
 
-    uint32_t PCR;
-    uint32_t OPCR;
+    uint64_t PCR;
+    uint64_t OPCR;
 
 public:
     void Reset();
@@ -143,12 +154,12 @@ public:
     uint8_t getAdaptationFieldExtensionFlag() const { return m_AdaptationFieldExtensionFlag; }
 
     uint64_t getPCRBase() const { return PCR_base; }
-    uint8_t getPCRExtension() const { return PCR_extension; }
-    uint32_t getPCR() const { return PCR; }
+    uint16_t getPCRExtension() const { return PCR_extension; }
+    uint64_t getPCR() const { return PCR; }
 
     uint64_t getOPCRBase() const { return OPCR_base; }
-    uint8_t getOPCRExtension() const { return OPCR_extension; }
-    uint32_t getOPCR() const { return OPCR; }
+    uint16_t getOPCRExtension() const { return OPCR_extension; }
+    uint64_t getOPCR() const { return OPCR; }
 
     uint8_t getSpliceCountdown() const { return SpliceCountDown; }
     uint8_t getStuffingBytes() const { return StuffingBytes; }
@@ -183,6 +194,8 @@ public:
     void Reset();
     int32_t Parse(const uint8_t* Input, const uint32_t DataLength);
     void Print() const;
+    bool SaveState(FILE* File) const;
+    bool LoadState(FILE* File);
 public:
     //PES packet header
     uint32_t getPacketStartCodePrefix() const { return m_PacketStartCodePrefix; }
@@ -204,6 +217,12 @@ public:
         AssemblingStarted,
         AssemblingContinue,
         AssemblingFinished,
+        ScrambledSkipped,
+        DuplicateDropped,
+        AssemblingGap,       // recovery mode - data lost, partial PES continues
+        PayloadAfterEnd,     // recovery mode - PES already finished, payload not appended
+        PartialFinished,     // emit partial - previous PES reported (getPartial*), new PES header broken
+        PartialFinishedAndStarted, // emit partial - previous PES reported (getPartial*), new PES started
     };
 protected:
     //setup
@@ -212,20 +231,55 @@ protected:
     uint8_t* m_Buffer;
     uint32_t m_BufferSize;
     uint32_t m_DataOffset;
+    uint8_t* m_PartialBuffer;       // unfinished PES reported on next PUSI
+    uint32_t m_PartialDataOffset;
     //operation
     int8_t m_LastContinuityCounter; 
     bool m_Started;
+    bool m_Finished;                // AssemblingFinished already reported for current PES
     xPES_PacketHeader m_PESH;
+    //recovery
+    bool m_RecoveryMode;
+    bool m_EmitPartial;
+    bool m_DuplicateSeen;           // last packet already had one duplicate
+    bool m_PendingDiscontinuity;    // discontinuity_indicator seen on packet without payload
+    bool m_LastWasStart;            // last absorbed packet had PUSI set
+    uint32_t m_NumGaps;             // gaps in current PES
+    uint32_t m_NumMissingPackets;   // TS packets missing in current PES (from CC)
+    uint32_t m_FirstGapOffset;      // byte offset of first gap in current PES
+    uint32_t m_PartialNumGaps;
+    uint32_t m_PartialNumMissingPackets;
+    uint32_t m_PartialFirstGapOffset;
+    //statistics
+    uint64_t m_NumDuplicates;
+    uint64_t m_NumExcessDuplicates; // same CC more than twice in a row - dropped as well
+    uint64_t m_NumDiscontinuities;
 
     FILE* m_OutputFile;
 public:
     xPES_Assembler();
     ~xPES_Assembler();
-    void Init(int32_t PID);
+    void Init(int32_t PID, bool Resume = false);
+    void setRecovery(bool RecoveryMode, bool EmitPartial) { m_RecoveryMode = RecoveryMode || EmitPartial; m_EmitPartial = EmitPartial; }
     eResult AbsorbPacket(const uint8_t* TransportStreamPacket, const xTS_PacketHeader* PacketHeader, const xTS_AdaptationField* AdaptationField);
     void PrintPESH() const { m_PESH.Print(); }
     uint8_t* getPacket() { return m_Buffer; }
     int32_t getNumPacketBytes() const { return m_DataOffset; }
+    int32_t getPID() const { return m_PID; }
+    uint64_t getNumDuplicates() const { return m_NumDuplicates; }
+    uint64_t getNumExcessDuplicates() const { return m_NumExcessDuplicates; }
+    uint64_t getNumDiscontinuities() const { return m_NumDiscontinuities; }
+    bool isPartial() const { return m_NumGaps > 0; }
+    uint32_t getNumGaps() const { return m_NumGaps; }
+    uint32_t getNumMissingPackets() const { return m_NumMissingPackets; }
+    uint32_t getFirstGapOffset() const { return m_FirstGapOffset; }
+    uint8_t* getPartialPacket() { return m_PartialBuffer; }
+    int32_t getNumPartialPacketBytes() const { return m_PartialDataOffset; }
+    uint32_t getPartialNumGaps() const { return m_PartialNumGaps; }
+    uint32_t getPartialNumMissingPackets() const { return m_PartialNumMissingPackets; }
+    uint32_t getPartialFirstGapOffset() const { return m_PartialFirstGapOffset; }
+    bool SaveState(FILE* File) const;
+    bool LoadState(FILE* File);
 protected:
     void xBufferReset();
     void xBufferAppend(const uint8_t* Data, int32_t Size);
@@ -233,3 +287,47 @@ protected:
 };
 
 //=============================================================================================================================================================================
+
+class xTS_ScramblingStatistics
+{
+public:
+    static constexpr int32_t NumPIDs = 8192; // 13 bit PID
+
+protected:
+    struct xPIDStatistics
+    {
+        uint64_t NumPackets;
+        uint64_t NumScrambled;
+        uint32_t NumKeySwitches;
+        uint8_t  LastTSC;
+        int64_t  LastSwitchPacketId;
+        int64_t  MinSwitchInterval;  // in TS packets
+        int64_t  MaxSwitchInterval;
+        int64_t  LastSwitchTime;     // stream time in 27MHz ticks, -1 if no PCR seen yet
+        int64_t  MinSwitchDuration;  // in 27MHz ticks
+        int64_t  MaxSwitchDuration;
+    };
+
+    xPIDStatistics* m_PIDs;
+    //stream clock - PCR of the first PID carrying PCR
+    int32_t  m_PCR_PID;
+    uint64_t m_LastPCR;
+    int64_t  m_StreamTime;           // 27MHz ticks since first PCR, unwrapped, -1 before first PCR
+
+public:
+    xTS_ScramblingStatistics();
+    ~xTS_ScramblingStatistics();
+    void Reset();
+    void AddPacket(const xTS_PacketHeader* PacketHeader, const xTS_AdaptationField* AdaptationField, int64_t PacketId);
+    void Print() const;
+    bool SaveState(FILE* File) const;
+    bool LoadState(FILE* File);
+public:
+    uint64_t getNumPackets(uint16_t PID) const { return m_PIDs[PID].NumPackets; }
+    uint64_t getNumScrambled(uint16_t PID) const { return m_PIDs[PID].NumScrambled; }
+    uint32_t getNumKeySwitches(uint16_t PID) const { return m_PIDs[PID].NumKeySwitches; }
+protected:
+    void xUpdateClock(const xTS_PacketHeader* PacketHeader, const xTS_AdaptationField* AdaptationField);
+};
+
+//=============================================================================================================================================================================